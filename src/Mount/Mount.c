@@ -589,23 +589,7 @@ INT_PTR CALLBACK SecureCopyDialogProc(HWND hwndDlg, UINT uMsg, WPARAM wParam, LP
                     break;
                 }
                 
-                // Dosya adını çıkar ve hedef yolu oluştur
-                wchar_t fileName[MAX_PATH];
-                wchar_t destPath[MAX_PATH];
-                _wsplitpath_s(sourcePath, NULL, 0, NULL, 0, fileName, MAX_PATH, NULL, 0);
-                swprintf_s(destPath, MAX_PATH, L"%s\\%s", destFolder, fileName);
-                
-                // Dosyayı kopyala
-                if (!CopyFileW(sourcePath, destPath, FALSE))
-                {
-                    DWORD err = GetLastError();
-                    wchar_t errMsg[256];
-                    swprintf_s(errMsg, 256, L"File copy failed! Error code: %lu", err);
-                    MessageBoxW(hwndDlg, errMsg, L"Error", MB_OK | MB_ICONERROR);
-                    break;
-                }
-                
-                // Kopyalama başarılı, şimdi orijinal dosyayı güvenli sil
+                // Kopyalama ve silme ayarları
                 ve_options_t options;
                 memset(&options, 0, sizeof(options));
                 options.algorithm = algorithm;
@@ -614,10 +598,13 @@ INT_PTR CALLBACK SecureCopyDialogProc(HWND hwndDlg, UINT uMsg, WPARAM wParam, LP
                 
                 // Wide char'dan multi byte'a çevir
                 char sourcePathA[MAX_PATH];
+                char destFolderA[MAX_PATH];
                 WideCharToMultiByte(CP_UTF8, 0, sourcePath, -1, sourcePathA, MAX_PATH, NULL, NULL);
+                WideCharToMultiByte(CP_UTF8, 0, destFolder, -1, destFolderA, MAX_PATH, NULL, NULL);
                 
-                // Güvenli silme işlemi
-                ve_status_t status = ve_erase_path(sourcePathA, &options);
+                // Hedef klasöre kopyala, doğrula, sonra orijinal dosyayı güvenli sil
+                // (kopyalama başarısız olursa kaynak dosyaya dokunulmaz)
+                ve_status_t status = ve_secure_copy(sourcePathA, destFolderA, &options);
                 if (status != VE_SUCCESS)
                 {
                     const char* errorMsg = ve_last_error_message();
@@ -628,7 +615,7 @@ INT_PTR CALLBACK SecureCopyDialogProc(HWND hwndDlg, UINT uMsg, WPARAM wParam, LP
                     }
                     else
                     {
-                        wcscpy_s(errorMsgW, 512, L"Secure deletion failed with unknown error");
+                        wcscpy_s(errorMsgW, 512, L"Secure copy failed with unknown error");
                     }
                     MessageBoxW(hwndDlg, errorMsgW, L"Error", MB_OK | MB_ICONERROR);
                 }
@@ -27,6 +27,8 @@ extern "C" {
   - VE_ERR_PERM: insufficient permissions (e.g., TRIM may require admin/root).
   - VE_ERR_UNSUPPORTED: requested feature not supported on current platform/FS.
   - VE_ERR_PARTIAL: best-effort operation could not process all items.
+  - VE_ERR_CANCELLED: the cancel token of an extended call was set (see
+    ve_options_ex_t for what the targets look like afterwards).
   - VE_ERR_INTERNAL: unexpected internal error.
 */
 typedef enum {
@@ -36,6 +38,7 @@ typedef enum {
     VE_ERR_PERM = -3,
     VE_ERR_UNSUPPORTED = -4,
     VE_ERR_PARTIAL = -5,
+    VE_ERR_CANCELLED = -6,
     VE_ERR_INTERNAL = -128
 } ve_status_t;
 
@@ -54,7 +57,10 @@ typedef enum {
   ve_algorithm_t
   ---------------
   Erasure algorithm choice. See PRD for behavioral details per algorithm.
-  - VE_ALG_SSD route performs encrypt-in-place + delete (+ TRIM best-effort).
+  - Every pass covers the file's allocated regions only; holes of sparse files
+    hold no data and are left unallocated.
+  - VE_ALG_SSD route performs encrypt-in-place + delete (+ TRIM best-effort). On
+    Linux ext4/XFS with root it discards the file's own extents before unlinking.
 */
 typedef enum {
     VE_ALG_ZERO = 0,
@@ -66,23 +72,83 @@ typedef enum {
     VE_ALG_SSD
 } ve_algorithm_t;
 
+/*
+  ve_container_mode_t
+  --------------------
+  Crypto-shred of VeraCrypt/TrueCrypt container files (options->container_mode).
+  - VE_CONTAINER_OFF: containers are erased like any other file.
+  - VE_CONTAINER_HEADERS: a file recognized as a container has its header areas
+    (first and last 128 KiB: primary, hidden-volume and backup headers)
+    overwritten with random data and verified by read-back, then it is deleted.
+    The data area stays ciphertext under keys that no longer exist.
+  - VE_CONTAINER_FULL: as HEADERS, then one cheap pass over the whole file (the
+    SSD flow for VE_ALG_SSD, a zero pass otherwise).
+  Recognition is heuristic (headers look like random data): sector-multiple size,
+  allocated header areas, no archive/compressed-format signature at the start,
+  uniform byte distribution in all four header areas. Compressed/encrypted files
+  can match too, so only files the caller names directly (a path given to
+  ve_erase_path(s) or the source of a single-file ve_secure_copy) are
+  considered; files found inside a directory, and files that do not match, get
+  the selected algorithm. ve_last_containers() lists the paths shredded.
+*/
+typedef enum {
+    VE_CONTAINER_OFF = 0,
+    VE_CONTAINER_HEADERS,
+    VE_CONTAINER_FULL
+} ve_container_mode_t;
+
 /*
   ve_options_t
   -------------
   Per-operation configuration. Callers should zero-initialize the struct,
   then override fields they need. Reasonable defaults:
     - algorithm = VE_ALG_NIST
-    - device_type = VE_DEVICE_AUTO
+    - device_type = VE_DEVICE_AUTO (per-device detection; SSD/HDD force the type)
     - trim_mode = 0 (auto)
   Notes:
     - passes: only used for VE_ALG_RANDOM (0 => default).
-    - verify: enables read-back verification (not implemented in this skeleton).
+    - verify: read every written pass back around the page cache and compare it
+      (pattern, or the random stream regenerated from the pass seed); a mismatch
+      fails the file with VE_ERR_IO and it is not unlinked. SSD encrypt-in-place
+      cannot be checked (no copy of the plaintext is kept); its keystream variant,
+      the free-space wipe, container passes and BLKZEROOUT are.
+    - verify_fraction: with verify, read back only this fraction of randomly picked
+      64 KiB blocks per pass, plus the first and last one (0 or >= 1 => all blocks).
     - trim_mode: 0=auto, 1=on, 2=off. TRIM is best-effort and platform-specific.
+      Deletions are collected per filesystem and trimmed once when the call ends.
+    - trim_batch_bytes: also trim a filesystem once this many erased bytes are
+      pending on it (0 => only at the end).
+    - trim_interval_ms: also trim a filesystem once its oldest pending deletion is
+      this old, checked as deletions arrive (0 => only at the end).
     - follow_symlinks: when 1, walker may traverse symlinks (default 0 recommended).
     - erase_ads: Windows NTFS Alternate Data Streams best-effort handling (unused here).
     - erase_xattr: extended attributes removal best-effort (unused here).
     - chunk_size: per-I/O buffer size in bytes (0 => built-in default in .c file).
-    - threads: reserved for future (0 => single-threaded processing).
+      Clamped to [64 KiB, 1 GiB] and rounded up to the page size; the engine keeps
+      page-aligned, locked buffers of this size for the whole call.
+    - threads: worker threads for directory erasure (0/1 => calling thread only).
+      Workers steal from each other's task deques; each holds its own chunk buffers.
+    - ssd_keystream: VE_ALG_SSD only; overwrite with a fresh AES-CTR keystream
+      instead of read+encrypt+rewrite (no read phase, roughly half the I/O).
+    - io_depth: outstanding chunk requests per file for the Linux io_uring backend
+      (0/1 => synchronous write() path, N>1 => io_uring). Each request holds one
+      chunk_size buffer. Falls back to the synchronous path if io_uring is unavailable.
+    - direct_io: bypass the page cache for overwrite/encrypt passes (Linux O_DIRECT
+      with the filesystem's alignment, buffered unaligned tail; macOS F_NOCACHE).
+      Silently buffered where unsupported.
+    - wipe_reserve: ve_wipe_free_space() leaves this many bytes free (0 => 1% of
+      the filesystem, at least 64 MiB).
+    - container_mode: header-only crypto-shred of VeraCrypt containers (see
+      ve_container_mode_t; default off).
+    - copy_fused: ve_secure_copy() scrubs the source window by window right behind
+      the copy (each window only once its copy is synced and compared) instead of
+      erasing it afterwards. Overwrite algorithms only.
+    - journal: optional path of a resume journal. Each call appends its target
+      list and options, then records which passes of each file (and up to which
+      offset within the running pass) are durable, and which copies are in
+      place. After a crash, ve_resume() on the same journal finishes the calls
+      that did not complete. Commits are grouped about every 2 s; the journal
+      file itself is never erased. Free-space wipes are not journaled.
     - dry_run: plan/print without modifying anything.
     - quiet: reduce console output (CLI mode only).
 */
@@ -90,24 +156,183 @@ typedef struct {
     ve_algorithm_t algorithm;        // Algorithm selection -> zero|random|dod3|dod7|nist|gutmann|ssd
     ve_device_type_t device_type;    // Device hint: auto|ssd|hdd
     int passes;                      // Random passes for VE_ALG_RANDOM (0 => default)
-    int verify;                      // 0/1 enable verification (if implemented)
+    int verify;                      // 0/1 read back and compare every written pass
     int trim_mode;                   // 0:auto, 1:on, 2:off
     int follow_symlinks;             // 0/1 follow symlinks during directory walk
     int erase_ads;                   // 0/1 best-effort NTFS ADS (Windows only; not implemented here)
     int erase_xattr;                 // 0/1 best-effort xattr removal (not implemented here)
     uint64_t chunk_size;             // I/O chunk size in bytes (0 => default)
-    int threads;                     // reserved for future parallelism (0 => single)
+    int threads;                     // directory workers (0/1 => single-threaded)
     int dry_run;                     // 0/1 no-op mode (report only)
     int quiet;                       // 0/1 reduce logging in CLI
+    int ssd_keystream;               // 0/1 SSD route: write keystream, skip read phase
+    int io_depth;                    // async queue depth (0/1 => synchronous)
+    int direct_io;                   // 0/1 bypass page cache during passes
+    uint64_t trim_batch_bytes;       // deferred TRIM byte threshold (0 => end of call)
+    int trim_interval_ms;            // deferred TRIM age threshold (0 => end of call)
+    uint64_t wipe_reserve;           // free-space wipe: bytes left free (0 => default)
+    ve_container_mode_t container_mode; // VeraCrypt container crypto-shred: off|headers|full
+    double verify_fraction;          // sampled verification: fraction of blocks read (0 => all)
+    int copy_fused;                  // 0/1 secure copy: scrub the source behind the copy
+    const char* journal;             // optional resume journal path (NULL => none)
 } ve_options_t;
 
+/*
+  ve_progress_t
+  --------------
+  One report of an extended call (ve_options_ex_t.progress).
+  - path: current target (NULL when it has no name, e.g. between files).
+  - pass/passes: 1-based pass of the target and its pass count; pass 0 is the
+    copy of a ve_secure_copy_ex() source.
+  - pass_done/pass_total: bytes of that pass (or copy) written of the target's
+    data bytes; holes count in neither.
+  - file_done/file_total: the same over all passes of the target.
+  - bytes_done: bytes written, encrypted and copied so far by the whole call.
+  - files_done: targets erased and unlinked so far (wipe files for a free-space wipe).
+  With several workers the report describes the target of the worker that
+  made it; bytes_done and files_done always cover the whole call.
+*/
+typedef struct {
+    const char* path;
+    int pass;
+    int passes;
+    uint64_t pass_done;
+    uint64_t pass_total;
+    uint64_t file_done;
+    uint64_t file_total;
+    uint64_t bytes_done;
+    uint64_t files_done;
+} ve_progress_t;
+
+/*
+  ve_progress_ex_fn
+  ------------------
+  Progress callback of an extended call. Called on an erasing thread, never by
+  two threads at once, at most once per progress_interval_ms; the report is
+  only valid during the call. It may call ve_cancel_request().
+*/
+typedef void (*ve_progress_ex_fn)(const ve_progress_t* progress, void* user);
+
+/*
+  ve_cancel_token_t
+  ------------------
+  Cooperative cancellation: zero-initialize, pass it in ve_options_ex_t.cancel
+  and call ve_cancel_request() from any thread (or the progress callback).
+*/
+typedef struct {
+    volatile long requested;
+} ve_cancel_token_t;
+
+/*
+  ve_options_ex_t
+  ----------------
+  Versioned options of the _ex calls: zero-initialize, set size =
+  sizeof(ve_options_ex_t) and version = VE_OPTIONS_EX_VERSION, then fill 'base'
+  as a ve_options_t.
+  - progress/progress_user: optional callback (see ve_progress_ex_fn). The
+    counters behind it are updated with relaxed atomics once per chunk, so a
+    callback costs nothing in the I/O loops between two reports.
+  - progress_interval_ms: minimum time between two reports (0 => 250 ms).
+  - cancel: optional token. It is checked once per chunk (a pattern pass may
+    write up to 8 chunks per system call) and before each file or entry. Once
+    seen, the call stops and returns VE_ERR_CANCELLED, leaving:
+      - files not reached yet untouched, and nothing unlinked that was not erased;
+      - the file being erased with its earlier passes complete, and the current
+        pass written and synced up to a chunk boundary (ve_last_error_message()
+        names the file, the pass and the offset it is durable below; with a
+        journal this is also checkpointed and ve_resume() continues there);
+      - a copy in progress removed with its source intact, or, for a fused copy
+        that had begun scrubbing, its temporary file kept as with VE_ERR_PARTIAL;
+      - copied sources not yet erased in place next to their verified copies;
+      - free-space wipe files removed.
+    A cancel request made after the last chunk may go unseen: the call then
+    simply succeeds.
+*/
+#define VE_OPTIONS_EX_VERSION 2
+
+typedef struct {
+    uint32_t size;                   // sizeof(ve_options_ex_t)
+    uint32_t version;                // VE_OPTIONS_EX_VERSION
+    ve_options_t base;               // everything ve_options_t offers
+    ve_progress_ex_fn progress;      // optional progress callback
+    void* progress_user;             // passed through to 'progress'
+    uint32_t progress_interval_ms;   // minimum time between reports (0 => 250 ms)
+    ve_cancel_token_t* cancel;       // optional cancel token
+} ve_options_ex_t;
+
+/*
+  ve_stats_t
+  -----------
+  Counters for one ve_erase_path()/ve_erase_paths()/ve_wipe_free_space() call.
+  - files_erased/bytes_erased: files overwritten and unlinked, and their sizes
+    (free-space wipe: wipe files written and removed).
+  - trims_requested: deletions that asked for a TRIM (trim_mode auto/on).
+  - trims_issued: FITRIM calls actually made (one per filesystem per flush).
+  - trims_coalesced: requests folded into another one (requested - issued).
+  - bytes_discarded: SSD route only; bytes discarded per file from the file's own
+    extents (Linux FIEMAP + BLKDISCARD, ext4/XFS, root). Those files need no FITRIM.
+  - links_deduplicated: further names of an already erased inode (hard links),
+    unlinked without another overwrite; not counted in files_erased.
+  - files_shared: files with extents shared with other files (reflinks,
+    snapshots; Linux FIEMAP). The other owners' copies were NOT erased.
+  - containers_shredded: files erased as VeraCrypt containers (container_mode);
+    also counted in files_erased.
+  - verify_blocks/verify_blocks_total: 64 KiB blocks read back, and blocks in the
+    verified passes (equal unless verify_fraction samples).
+  - verify_confidence: for the weakest verified pass, the probability that it
+    would have been caught had 1% of its blocks not been overwritten (1.0 with
+    full verification; meaningful only when verify_blocks_total > 0).
+  - bytes_copied/files_copied/copy_ms/erase_ms: ve_secure_copy() only; data bytes
+    and files copied, time spent copying (including sync and compare) and time
+    spent erasing the source. With copy_fused the scrub runs inside copy_ms and
+    erase_ms is the final TRIM. For a tree the two stages overlap: copy_ms runs
+    from the start (scan included) to the last verified copy, erase_ms from the
+    first verified copy to the removal of the last source directory.
+  - copy_idle_ms/erase_idle_ms: trees only; time the copy workers waited for a
+    device slot and the erase workers waited for verified copies (or a slot),
+    summed over workers. A busy erase stage with idle copiers means the source
+    erasure is the bottleneck, and the other way around.
+  - copy_digest: ve_secure_copy() of a file only; 128-bit digest of the copy
+    (low word first), taken while copying and matched by one read of the copy.
+    Built from XXH3-128 of each 64 KiB leaf; it depends on the contents and
+    size only (holes count as zeros).
+*/
+typedef struct {
+    uint64_t files_erased;
+    uint64_t bytes_erased;
+    uint64_t trims_requested;
+    uint64_t trims_issued;
+    uint64_t trims_coalesced;
+    uint64_t bytes_discarded;
+    uint64_t links_deduplicated;
+    uint64_t files_shared;
+    uint64_t containers_shredded;
+    uint64_t verify_blocks;
+    uint64_t verify_blocks_total;
+    double verify_confidence;
+    uint64_t bytes_copied;
+    uint64_t files_copied;
+    uint64_t copy_ms;
+    uint64_t erase_ms;
+    uint64_t copy_idle_ms;
+    uint64_t erase_idle_ms;
+    uint64_t copy_digest[2];
+} ve_stats_t;
+
 /*
   ve_erase_path
   --------------
   High-level entry point.
   - If 'path' is a file: applies selected algorithm to the file, then unlinks it.
-  - If 'path' is a directory: recursively processes its content; attempts to remove
-    directories when empty.
+  - If 'path' is a block device (Linux: disk, partition, loop, dm): overwrites the
+    whole device with the selected algorithm using direct I/O. The device must not
+    be mounted or otherwise in use (it is opened exclusively). zero uses
+    BLKZEROOUT and ssd uses BLKSECDISCARD (else keystream + BLKDISCARD) when the
+    device supports them. Nothing is unlinked.
+  - If 'path' is a directory: processes its content (iteratively, on options->threads
+    workers) and removes each directory once its entries are gone. Returns
+    VE_ERR_PARTIAL if some entries could not be erased or removed. Hard links
+    to one inode are overwritten once; its other names are only unlinked.
   Inputs:
     - path: UTF-8 or native narrow string path (Windows ANSI for this build).
     - options: required pointer to options (non-NULL). See ve_options_t.
@@ -115,6 +340,80 @@ typedef struct {
 */
 ve_status_t ve_erase_path(const char* path, const ve_options_t* options);
 
+/*
+  ve_erase_paths
+  ---------------
+  Erase several files and/or directory trees in one call; block devices among
+  them are erased one after another once the rest is done. All targets share one
+  worker pool (options->threads); erasures are scheduled per storage device, so a
+  rotational disk gets one file at a time while other devices drain in parallel.
+  Inputs:
+    - paths/count: array of 'count' non-NULL path strings.
+    - options: required pointer to options (non-NULL). device_type, when not AUTO,
+      overrides detection for every device.
+  Returns: VE_SUCCESS, or VE_ERR_PARTIAL if some entries could not be processed.
+*/
+ve_status_t ve_erase_paths(const char* const* paths, size_t count, const ve_options_t* options);
+
+/*
+  ve_secure_copy
+  ---------------
+  Copy file 'src' to 'dst' (a file name, or an existing directory to copy into
+  under the source's name), then erase 'src' with ve_erase_path() semantics.
+  The copy is written under a temporary name and hashed on the way, synced,
+  read back once around the page cache and hashed again, and only then renamed
+  into place (the digest is reported in ve_stats_t.copy_digest); mode
+  and timestamps follow the source. The source is erased only after all of
+  that succeeded, so on any copy error it is left untouched.
+  - The copy is a pipelined read/write of the source's data regions; holes of
+    sparse sources are preserved.
+  - options->copy_fused overwrites each source window as soon as its copy is
+    durable and checked, overlapping copy and erase. A failure after that
+    point keeps the temporary file, which then holds the overwritten part.
+  - A directory 'src' is copied as a tree (into dst/<name> when 'dst' exists,
+    merging with what is there, else as 'dst'). Directories are mirrored with
+    their modes and timestamps, symlinks recreated, and hard links within the
+    tree copied once and linked again (POSIX). Files are copied on
+    options->threads workers while as many workers erase the sources of the
+    copies already verified; each storage device takes a bounded number of
+    them at a time (one on rotational disks). Only verified sources are
+    erased, and source directories are removed once empty.
+  Returns: VE_SUCCESS, VE_ERR_INVALID_ARG ('src' a block device, both names the
+  same file, or 'dst' inside the tree), VE_ERR_IO, VE_ERR_PARTIAL (fused copy
+  failed after scrubbing began, see ve_last_error_message() for the temporary
+  file; or tree entries that were not copied or erased, their sources kept).
+*/
+ve_status_t ve_secure_copy(const char* src, const char* dst, const ve_options_t* options);
+
+/*
+  ve_resume
+  ----------
+  Finish the calls recorded in resume journal 'journal' (options->journal) that
+  did not complete, in their order and with their original options. Targets
+  that no longer exist are skipped. A file continues at its first incomplete
+  pass, from the last checkpointed offset of that pass (a random pass under
+  verify starts over, its stream being unrecoverable); files whose passes were
+  all done are only removed, and copies already in place are not made again.
+  A fused copy interrupted after it began scrubbing is not resumed.
+  Statistics of all resumed calls are summed for ve_last_stats(), except
+  verify_confidence (that of the weakest verified call) and copy_digest (that
+  of the last resumed copy).
+  Returns: VE_SUCCESS (also when nothing was left to do), VE_ERR_INVALID_ARG
+  (not a journal, or damaged), or the status of the first resumed call that failed.
+*/
+ve_status_t ve_resume(const char* journal);
+
+/*
+  ve_resume_ex
+  -------------
+  ve_resume() with progress reports and cancellation from 'options' (see the
+  extended calls below). options->base is ignored: every call resumes with the
+  options it was journaled with. A cancel stops the resumed call in progress
+  as it would the original one, checkpointed in the journal, and skips the
+  calls after it; VE_ERR_CANCELLED is returned.
+*/
+ve_status_t ve_resume_ex(const char* journal, const ve_options_ex_t* options);
+
 /*
   ve_trim_free_space
   -------------------
@@ -128,11 +427,49 @@ ve_status_t ve_erase_path(const char* path, const ve_options_t* options);
 */
 ve_status_t ve_trim_free_space(const char* mount_or_volume_path, int aggressive);
 
+/*
+  ve_wipe_free_space
+  -------------------
+  Overwrite the free space of the filesystem holding directory 'dir', for residue
+  of files deleted without this engine. Fills free space with hidden wipe files
+  (options->threads in parallel, selected algorithm; ssd => one keystream pass),
+  syncs and removes them, then TRIMs (trim_mode). options->wipe_reserve bytes
+  are always left free so other writers do not run out of space. Slack space of
+  live files and filesystem metadata are not covered, nor are blocks reserved
+  for root (ext4 -m) or by the filesystem itself.
+  Returns: VE_SUCCESS, VE_ERR_INVALID_ARG if 'dir' is not a directory, or VE_ERR_IO.
+*/
+ve_status_t ve_wipe_free_space(const char* dir, const ve_options_t* options);
+
+/*
+  Extended calls
+  ---------------
+  ve_erase_path(), ve_erase_paths(), ve_secure_copy() and ve_wipe_free_space()
+  with a ve_options_ex_t: the same behavior, plus progress reports and
+  cancellation. Each returns VE_ERR_INVALID_ARG when options->version is not
+  VE_OPTIONS_EX_VERSION or options->size is smaller than this library's
+  ve_options_ex_t, and VE_ERR_CANCELLED once the cancel token was seen.
+*/
+ve_status_t ve_erase_path_ex(const char* path, const ve_options_ex_t* options);
+ve_status_t ve_erase_paths_ex(const char* const* paths, size_t count, const ve_options_ex_t* options);
+ve_status_t ve_secure_copy_ex(const char* src, const char* dst, const ve_options_ex_t* options);
+ve_status_t ve_wipe_free_space_ex(const char* dir, const ve_options_ex_t* options);
+
+/*
+  ve_cancel_request
+  ------------------
+  Ask the calls using 'token' to stop at their next chunk boundary. Safe from
+  any thread; the token stays set until the caller zeroes it again.
+*/
+void ve_cancel_request(ve_cancel_token_t* token);
+
 /*
   ve_detect_device_type
   ----------------------
-  Best-effort device type detection heuristic for the given path. Placeholder in
-  this skeleton, returns VE_DEVICE_AUTO.
+  Best-effort device type detection for the given path: Linux reads the
+  rotational flag of the backing block device from sysfs, Windows queries the
+  seek penalty of the volume's disk. Returns VE_DEVICE_AUTO when unknown
+  (virtual filesystems, network shares, other platforms).
 */
 ve_device_type_t ve_detect_device_type(const char* path);
 
@@ -144,6 +481,23 @@ ve_device_type_t ve_detect_device_type(const char* path);
 */
 const char* ve_last_error_message(void);
 
+/*
+  ve_last_stats
+  --------------
+  Copy the statistics of the last erase or wipe call made on
+  the current thread into 'out' (zeroes if none).
+*/
+void ve_last_stats(ve_stats_t* out);
+
+/*
+  ve_last_containers
+  -------------------
+  Paths the last call on the current thread erased as VeraCrypt containers
+  (container_mode), one per line, or NULL if none. Valid until the next call
+  on this thread.
+*/
+const char* ve_last_containers(void);
+
 #ifdef __cplusplus
 }
 #endif
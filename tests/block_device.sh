@@ -0,0 +1,124 @@
+#!/bin/sh
+#
+# Block-device erase on loop devices (root and losetup; skipped otherwise)
+# - odd tail: an 8 MiB + 1536 byte device (not a multiple of the 4 KiB page
+#   or the chunk) erased with dod3 and with zero under --verify; the size is
+#   unchanged, the backing file was not extended, and every byte changed;
+# - a device holding a mounted filesystem is refused (opened O_EXCL: EBUSY)
+#   and left intact;
+# - zero on a device that advertises write-zeroes goes through BLKZEROOUT:
+#   the ext4 backing file is left with unwritten (zeroed) extents;
+# - zero on a device without write-zeroes (backing file on ramfs) falls back
+#   to written passes, and the device reads back as zeros.
+#
+# Run through tests/run.sh, which sets $VERASER and $VE_TEST_DIR.
+
+set -u
+
+[ "$(id -u)" -eq 0 ] || { echo "block_device: needs root"; exit 77; }
+for tool in losetup blockdev mkfs.ext4 mount umount cmp; do
+    command -v $tool >/dev/null 2>&1 || { echo "block_device: $tool not found"; exit 77; }
+done
+
+dir=$VE_TEST_DIR
+size=$((8 * 1024 * 1024 + 1536))
+loops=""
+mounts=""
+
+# Loops first: one of them is backed by a file on the ramfs mount
+cleanup() {
+    for l in $loops; do losetup -d "$l" 2>/dev/null; done
+    for m in $mounts; do umount "$m" 2>/dev/null; done
+}
+trap cleanup EXIT
+
+fail() {
+    echo "FAIL: $*" >&2
+    exit 1
+}
+
+# Attach $1 to a free loop device, named in $dev
+attach() {
+    dev=$(losetup -f --show "$1") || fail "losetup $1"
+    loops="$dev $loops"
+}
+
+# Fill a file with $2 bytes of 0xA5
+marker() {
+    head -c "$2" /dev/zero | tr '\000' '\245' > "$1"
+}
+
+# Number of bytes in which the last $3 bytes of $1 and $2 differ
+tail_diff() {
+    tail -c "$3" "$1" > "$dir/tail.a"
+    tail -c "$3" "$2" > "$dir/tail.b"
+    cmp -l "$dir/tail.a" "$dir/tail.b" | wc -l
+}
+
+queue() {
+    cat "/sys/block/$(basename "$1")/queue/$2" 2>/dev/null || echo 0
+}
+
+# --- odd tail, written passes -------------------------------------------------
+marker "$dir/odd.img" $size
+cp "$dir/odd.img" "$dir/odd.orig"
+attach "$dir/odd.img"
+[ "$(blockdev --getsize64 "$dev")" -eq $size ] || fail "loop size is not $size"
+"$VERASER" --path "$dev" --algorithm dod3 --verify --quiet || fail "dod3 on $dev"
+[ "$(blockdev --getsize64 "$dev")" -eq $size ] || fail "device size changed"
+[ "$(stat -c %s "$dir/odd.img")" -eq $size ] || fail "backing file size changed"
+cmp -s "$dev" "$dir/odd.orig" && fail "dod3 left the device unchanged"
+# Random data matches the marker in about 1 byte in 256
+changed=$(tail_diff "$dev" "$dir/odd.orig" 1536)
+[ "$changed" -ge 1480 ] || fail "dod3 changed only $changed of the last 1536 bytes"
+changed=$(cmp -l "$dev" "$dir/odd.orig" | wc -l)
+[ "$changed" -ge $((size - size / 128)) ] || fail "dod3 changed only $changed of $size bytes"
+
+"$VERASER" --path "$dev" --algorithm zero --verify --quiet || fail "zero on $dev"
+cmp -s -n $size "$dev" /dev/zero || fail "zero left non-zero bytes"
+[ "$(stat -c %s "$dir/odd.img")" -eq $size ] || fail "backing file size changed"
+
+# --- mounted device is refused ------------------------------------------------
+truncate -s 32M "$dir/fs.img"
+mkfs.ext4 -q -F "$dir/fs.img" || fail "mkfs.ext4"
+attach "$dir/fs.img"
+mkdir -p "$dir/mnt"
+mount "$dev" "$dir/mnt" || fail "mount $dev"
+mounts="$dir/mnt $mounts"
+echo keep > "$dir/mnt/file"
+sync
+out=$("$VERASER" --path "$dev" --algorithm zero 2>&1)
+rc=$?
+[ $rc -eq 4 ] || fail "mounted device: exit $rc, expected 4"
+echo "$out" | grep -q "mounted or in use" || fail "unexpected refusal: $out"
+[ "$(cat "$dir/mnt/file")" = keep ] || fail "mounted filesystem changed"
+umount "$dir/mnt" && mounts=""
+
+# --- BLKZEROOUT fast path ------------------------------------------------------
+marker "$dir/zero.img" $size
+attach "$dir/zero.img"
+if [ "$(queue "$dev" write_zeroes_max_bytes)" -eq 0 ]; then
+    echo "block_device: $dev has no write-zeroes; BLKZEROOUT not covered"
+else
+    "$VERASER" --path "$dev" --algorithm zero --quiet || fail "zero on $dev"
+    cmp -s -n $size "$dev" /dev/zero || fail "BLKZEROOUT left non-zero bytes"
+    if command -v filefrag >/dev/null 2>&1; then
+        filefrag -v "$dir/zero.img" | grep -q unwritten || fail "zero did not go through BLKZEROOUT"
+    fi
+fi
+
+# --- written fallback without write-zeroes -------------------------------------
+mkdir -p "$dir/ram"
+if mount -t ramfs ramfs "$dir/ram" 2>/dev/null; then
+    mounts="$dir/ram $mounts"
+    marker "$dir/ram/plain.img" $size
+    attach "$dir/ram/plain.img"
+    [ "$(queue "$dev" write_zeroes_max_bytes)" -eq 0 ] || fail "ramfs-backed $dev advertises write-zeroes"
+    "$VERASER" --path "$dev" --algorithm zero --verify --quiet || fail "zero (written) on $dev"
+    cmp -s -n $size "$dev" /dev/zero || fail "written zero pass left non-zero bytes"
+    [ "$(stat -c %s "$dir/ram/plain.img")" -eq $size ] || fail "backing file size changed"
+else
+    echo "block_device: cannot mount ramfs; written fallback not covered"
+fi
+
+echo "block_device: ok"
@@ -0,0 +1,146 @@
+#!/bin/sh
+#
+# Per-extent discard of the ssd flow on loop-mounted filesystems
+# (root, losetup, mkfs.ext4 and filefrag; skipped otherwise)
+# - ext4, and xfs when mkfs.xfs is available: a file erased with --algorithm
+#   ssd --trim on reports exactly its FIEMAP extents as discarded, those
+#   device ranges read back as zeros (the loop device punched them out of its
+#   backing file), and the files written between its extents are intact.
+# - xfs with reflink: a file sharing its extents with a clone
+#   (FIEMAP_EXTENT_SHARED) is not discarded, the shared-extent warning is
+#   printed, and the clone still holds the data.
+# - xfs with a realtime device (needs xfs_io): a realtime file's extents are
+#   offsets on the realtime device, so nothing is discarded, and the data
+#   device still holds the file written alongside it.
+#
+# Run through tests/run.sh, which sets $VERASER and $VE_TEST_DIR.
+
+set -u
+
+[ "$(id -u)" -eq 0 ] || { echo "extent_discard: needs root"; exit 77; }
+for tool in losetup mkfs.ext4 filefrag mount umount cmp sha1sum; do
+    command -v $tool >/dev/null 2>&1 || { echo "extent_discard: $tool not found"; exit 77; }
+done
+
+dir=$VE_TEST_DIR
+loop=""
+rtloop=""
+
+cleanup() {
+    umount "$dir/mnt" 2>/dev/null
+    [ -n "$loop" ] && losetup -d "$loop" 2>/dev/null
+    [ -n "$rtloop" ] && losetup -d "$rtloop" 2>/dev/null
+}
+trap cleanup EXIT
+
+fail() {
+    echo "FAIL: $*" >&2
+    exit 1
+}
+
+# Fresh 512 MiB filesystem of type $1 (mkfs arguments follow) mounted on $dir/mnt
+make_fs() {
+    cleanup
+    loop=""
+    rm -f "$dir/fs.img"
+    truncate -s 512M "$dir/fs.img"
+    fs=$1
+    shift
+    "mkfs.$fs" "$@" "$dir/fs.img" >/dev/null 2>&1 || fail "mkfs.$fs $*"
+    loop=$(losetup -f --show "$dir/fs.img") || fail "losetup"
+    mkdir -p "$dir/mnt"
+    mount "$loop" "$dir/mnt" || fail "mount $fs"
+}
+
+# "physical length" lines, in bytes, of the extents of $1
+extents() {
+    filefrag -v "$1" | awk '
+        /blocks of [0-9]+ bytes/ { for (i = 1; i <= NF; ++i) if ($i == "of") bs = $(i + 1) }
+        /^ *[0-9]+:/ { sub(/\.\./, "", $4); sub(/:/, "", $6); print $4 * bs, $6 * bs }'
+}
+
+# Whether $2 bytes of the loop device at byte $1 read back as zeros
+zeros_at() {
+    dd if="$loop" bs=4096 skip=$(($1 / 4096)) count=$((($2 + 4095) / 4096)) 2>/dev/null |
+        cmp -s -n "$2" - /dev/zero
+}
+
+discard_test() {
+    fs=$1
+    # Interleave the victim with neighbours so it gets several extents; odd tail at the end
+    : > "$dir/mnt/victim"
+    for i in 1 2 3 4 5 6; do
+        head -c 262144 /dev/urandom >> "$dir/mnt/victim"
+        sync
+        head -c 131072 /dev/urandom > "$dir/mnt/keep$i"
+        sync
+    done
+    head -c 4093 /dev/urandom >> "$dir/mnt/victim"
+    sync
+    (cd "$dir/mnt" && sha1sum keep*) > "$dir/keep.sum"
+    extents "$dir/mnt/victim" > "$dir/extents"
+    [ "$(wc -l < "$dir/extents")" -ge 2 ] || fail "$fs: victim was not fragmented"
+    total=$(awk '{ s += $2 } END { print s }' "$dir/extents")
+
+    out=$("$VERASER" --path "$dir/mnt/victim" --algorithm ssd --trim on 2>&1) || fail "$fs: erase: $out"
+    echo "$out" | grep -q " $total bytes discarded per file" ||
+        fail "$fs: expected $total bytes discarded: $(echo "$out" | tail -1)"
+    umount "$dir/mnt" || fail "umount"
+    while read -r phys len; do
+        zeros_at "$phys" "$len" || fail "$fs: extent at $phys (+$len) was not discarded"
+    done < "$dir/extents"
+    mount "$loop" "$dir/mnt" || fail "remount $fs"
+    (cd "$dir/mnt" && sha1sum -c --quiet "$dir/keep.sum") || fail "$fs: neighbouring files changed"
+    echo "extent_discard: $fs: $(wc -l < "$dir/extents") extents, $total bytes discarded"
+}
+
+make_fs ext4 -q -F -b 4096
+discard_test ext4
+
+if ! command -v mkfs.xfs >/dev/null 2>&1; then
+    echo "extent_discard: mkfs.xfs not found; xfs and shared extents not covered"
+    echo "extent_discard: ok"
+    exit 0
+fi
+
+make_fs xfs -f -m reflink=1
+discard_test xfs
+
+# Shared extents: the clone keeps the data, so nothing may be discarded
+head -c $((2 * 1024 * 1024)) /dev/urandom > "$dir/mnt/victim"
+cp --reflink=always "$dir/mnt/victim" "$dir/mnt/clone" || fail "xfs: reflink copy"
+sync
+(cd "$dir/mnt" && sha1sum clone) > "$dir/clone.sum"
+filefrag -v "$dir/mnt/victim" | grep -q shared || fail "xfs: clone extents not reported shared"
+out=$("$VERASER" --path "$dir/mnt/victim" --algorithm ssd --trim on 2>&1) || fail "xfs: erase: $out"
+echo "$out" | grep -q " 0 bytes discarded per file" || fail "xfs: shared extents discarded: $(echo "$out" | tail -2)"
+echo "$out" | grep -q "1 files shared extents" || fail "xfs: no shared-extent warning"
+umount "$dir/mnt" && mount "$loop" "$dir/mnt" || fail "xfs: remount"
+(cd "$dir/mnt" && sha1sum -c --quiet "$dir/clone.sum") || fail "xfs: clone changed"
+
+# Realtime file: FIEMAP offsets are on the realtime device, not behind st_dev
+if ! command -v xfs_io >/dev/null 2>&1; then
+    echo "extent_discard: xfs_io not found; realtime files not covered"
+    echo "extent_discard: ok"
+    exit 0
+fi
+cleanup
+loop=""
+rm -f "$dir/fs.img"
+truncate -s 512M "$dir/fs.img" "$dir/rt.img"
+loop=$(losetup -f --show "$dir/fs.img") || fail "losetup"
+rtloop=$(losetup -f --show "$dir/rt.img") || fail "losetup rt"
+mkfs.xfs -f -r rtdev="$rtloop" "$loop" >/dev/null 2>&1 || fail "mkfs.xfs -r rtdev"
+mount -o rtdev="$rtloop" "$loop" "$dir/mnt" || fail "mount xfs with rtdev"
+: > "$dir/mnt/victim"
+xfs_io -c "chattr +r" "$dir/mnt/victim" || fail "xfs: chattr +r"
+head -c $((2 * 1024 * 1024)) /dev/urandom >> "$dir/mnt/victim"
+head -c $((8 * 1024 * 1024)) /dev/urandom > "$dir/mnt/keep"
+sync
+(cd "$dir/mnt" && sha1sum keep) > "$dir/keep.sum"
+out=$("$VERASER" --path "$dir/mnt/victim" --algorithm ssd --trim on 2>&1) || fail "xfs rt: erase: $out"
+echo "$out" | grep -q " 0 bytes discarded per file" || fail "xfs rt: realtime extents discarded: $(echo "$out" | tail -2)"
+umount "$dir/mnt" && mount -o rtdev="$rtloop" "$loop" "$dir/mnt" || fail "xfs rt: remount"
+(cd "$dir/mnt" && sha1sum -c --quiet "$dir/keep.sum") || fail "xfs rt: data device file changed"
+
+echo "extent_discard: ok"
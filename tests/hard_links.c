@@ -0,0 +1,133 @@
+/*
+  Hard links under parallel directory erasure
+  - A directory holds one file under several names (and a few plain files),
+    erased with 4 workers, so the names of the inode reach different workers
+    at once.
+  - Cancelled during the first pass of the shared inode (held long enough for
+    the other workers to reach its other names): every name is still there,
+    since none may be unlinked before its data was overwritten.
+  - Run again to completion: every name is gone, the inode counts once in
+    files_erased and its other names in links_deduplicated.
+*/
+static void test_after_pass(void* eng, int fd, int pass);
+#define VE_TEST_PASS_HOOK(eng, fd, pass) test_after_pass((eng), (fd), (pass))
+
+#include "../src/Mount/veraser.c"
+
+#include <stdio.h>
+
+#define NAMES 6
+#define PLAIN 3
+#define FILE_SIZE (1024u * 1024u + 4093u)
+
+static ve_cancel_token_t cancel;
+static ve_inode_key_t shared;
+static int cancel_in_pass;   /* 0: never cancel */
+static volatile long hooked;
+
+static void test_after_pass(void* eng, int fd, int pass) {
+    (void)eng;
+    ve_inode_key_t key;
+    uint64_t nlink = 0;
+    if (cancel_in_pass == 0 || pass != cancel_in_pass || ve_file_identity(fd, &key, &nlink) != 0 ||
+        key.dev != shared.dev || key.ino != shared.ino || ve_atomic_add(&hooked, 1) != 1) {
+        return;
+    }
+    usleep(300 * 1000); /* the other workers open the other names meanwhile */
+    ve_cancel_request(&cancel);
+}
+
+static int make_tree(void) {
+    static unsigned char data[FILE_SIZE];
+    memset(data, 0xA5, sizeof(data));
+    char name[64];
+    if (mkdir("tree", 0700) != 0 && errno != EEXIST) {
+        return -1;
+    }
+    int fd = open("tree/link0", O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0 || write(fd, data, sizeof(data)) != (ssize_t)sizeof(data)) {
+        return -1;
+    }
+    uint64_t nlink = 0;
+    if (ve_file_identity(fd, &shared, &nlink) != 0 || close(fd) != 0) {
+        return -1;
+    }
+    for (int i = 1; i < NAMES; ++i) {
+        snprintf(name, sizeof(name), "tree/link%d", i);
+        if (link("tree/link0", name) != 0) {
+            return -1;
+        }
+    }
+    for (int i = 0; i < PLAIN; ++i) {
+        snprintf(name, sizeof(name), "tree/plain%d", i);
+        fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        if (fd < 0 || write(fd, data, 4096) != 4096 || close(fd) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static ve_status_t erase_tree(int pass) {
+    ve_options_ex_t ex;
+    memset(&ex, 0, sizeof(ex));
+    ex.size = sizeof(ex);
+    ex.version = VE_OPTIONS_EX_VERSION;
+    ex.base.algorithm = VE_ALG_DOD3;
+    ex.base.chunk_size = 64 * 1024;
+    ex.base.threads = 4;
+    ex.base.device_type = VE_DEVICE_SSD; /* no per-device limit: the names run in parallel */
+    ex.base.trim_mode = 2;
+    ex.cancel = &cancel;
+    memset(&cancel, 0, sizeof(cancel));
+    cancel_in_pass = pass;
+    hooked = 0;
+    return ve_erase_path_ex("tree", &ex);
+}
+
+int main(void) {
+    char name[64];
+    if (make_tree() != 0) {
+        perror("tree");
+        return 1;
+    }
+
+    ve_status_t rc = erase_tree(1);
+    if (rc != VE_ERR_CANCELLED) {
+        fprintf(stderr, "FAIL: cancelled erase: status %d, expected %d\n", (int)rc, (int)VE_ERR_CANCELLED);
+        return 1;
+    }
+    for (int i = 0; i < NAMES; ++i) {
+        snprintf(name, sizeof(name), "tree/link%d", i);
+        if (access(name, F_OK) != 0) {
+            fprintf(stderr, "FAIL: '%s' unlinked by a cancelled erase of its inode\n", name);
+            return 1;
+        }
+    }
+
+    /* Plain files the cancelled call reached are gone already */
+    int plain = 0;
+    for (int i = 0; i < PLAIN; ++i) {
+        snprintf(name, sizeof(name), "tree/plain%d", i);
+        plain += access(name, F_OK) == 0;
+    }
+
+    rc = erase_tree(0);
+    if (rc != VE_SUCCESS) {
+        fprintf(stderr, "FAIL: erase: status %d: %s\n", (int)rc, ve_last_error_message());
+        return 1;
+    }
+    if (access("tree", F_OK) == 0) {
+        fprintf(stderr, "FAIL: 'tree' still exists\n");
+        return 1;
+    }
+    ve_stats_t st;
+    ve_last_stats(&st);
+    if (st.links_deduplicated != NAMES - 1 || st.files_erased != (uint64_t)plain + 1) {
+        fprintf(stderr, "FAIL: %llu files erased, %llu links deduplicated; expected %d, %d\n",
+            (unsigned long long)st.files_erased, (unsigned long long)st.links_deduplicated, plain + 1, NAMES - 1);
+        return 1;
+    }
+    printf("hard_links: ok\n");
+    return 0;
+}
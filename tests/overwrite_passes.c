@@ -0,0 +1,181 @@
+/*
+  Multi-pass overwrites (dod3, dod7, gutmann)
+  - The file starts out, and is refilled after every checked pass, with a
+    marker byte. After every pass it still has its original size and holds
+    no run of 8 marker bytes anywhere, nor of 3 at its end, so no pass
+    appended past EOF or skipped any part of [0, size), odd tail included.
+    (The verify runs also have the engine read every byte back.)
+  - Each pass writes fresh data that does not repeat: every 16-byte unit
+    differs from what the pass before wrote, and all 4 KiB blocks of a pass
+    are distinct.
+  - Run with synchronous writes, io_uring and direct I/O, with and without
+    read-back verification; 64 KiB chunks make every pass many writes long.
+*/
+static void test_after_pass(void* eng, int fd, int pass);
+#define VE_TEST_PASS_HOOK(eng, fd, pass) test_after_pass((eng), (fd), (pass))
+
+#include "../src/Mount/veraser.c"
+
+#include <stdio.h>
+
+#define FILE_SIZE (3u * 1024u * 1024u + 4093u)  /* 48 chunks and an odd tail */
+#define BLOCK 4096u
+#define BLOCKS ((FILE_SIZE + BLOCK - 1) / BLOCK)
+#define UNIT 16u                                 /* random data repeats here with odds 2^-128 */
+#define MARKER 0xA5
+#define MARKER_RUN 8                             /* odds 2^-64 per offset in random data */
+#define MARKER_TAIL 3                            /* ... and 2^-24 per pass at the end */
+
+static unsigned char* previous;  /* data of the pass before the one being checked */
+static unsigned char* current;
+static unsigned char marker[BLOCK];
+static int passes_seen;
+static int failed;
+
+
+static int block_cmp(const void* a, const void* b) {
+    return memcmp(*(const unsigned char* const*)a, *(const unsigned char* const*)b, BLOCK);
+}
+
+static void test_after_pass(void* eng, int fd, int pass) {
+    (void)eng;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size != FILE_SIZE) {
+        fprintf(stderr, "FAIL: pass %d: size %lld, expected %u\n", pass, (long long)st.st_size, FILE_SIZE);
+        failed = 1;
+        return;
+    }
+    if (ve_pread_all(fd, current, FILE_SIZE, 0) != 0) {
+        fprintf(stderr, "FAIL: pass %d: read back failed\n", pass);
+        failed = 1;
+        return;
+    }
+    size_t run = 0;
+    for (size_t off = 0; off < FILE_SIZE; ++off) {
+        run = current[off] == MARKER ? run + 1 : 0;
+        if (run == MARKER_RUN || (off + 1 == FILE_SIZE && run >= MARKER_TAIL)) {
+            fprintf(stderr, "FAIL: pass %d: bytes before %zu (of %u) not written\n", pass, off + 1, FILE_SIZE);
+            failed = 1;
+            return;
+        }
+    }
+    for (size_t off = 0; pass > 1 && off < FILE_SIZE; off += UNIT) {
+        size_t n = FILE_SIZE - off < UNIT ? FILE_SIZE - off : UNIT;
+        if (memcmp(current + off, previous + off, n) == 0) {
+            fprintf(stderr, "FAIL: pass %d: bytes at %zu repeat the previous pass\n", pass, off);
+            failed = 1;
+            return;
+        }
+    }
+    /* Whole blocks only: a repeating pattern makes two of them equal */
+    static const unsigned char* sorted[BLOCKS];
+    for (size_t b = 0; b + 1 < BLOCKS; ++b) {
+        sorted[b] = current + b * BLOCK;
+    }
+    qsort(sorted, BLOCKS - 1, sizeof(sorted[0]), block_cmp);
+    for (size_t b = 1; b + 1 < BLOCKS; ++b) {
+        if (memcmp(sorted[b - 1], sorted[b], BLOCK) == 0) {
+            fprintf(stderr, "FAIL: pass %d: repeated 4 KiB block\n", pass);
+            failed = 1;
+            return;
+        }
+    }
+    memcpy(previous, current, FILE_SIZE);
+    passes_seen++;
+    for (size_t off = 0; off < FILE_SIZE; off += BLOCK) {
+        size_t n = FILE_SIZE - off < BLOCK ? FILE_SIZE - off : BLOCK;
+        if (pwrite(fd, marker, n, (off_t)off) != (ssize_t)n) {
+            fprintf(stderr, "FAIL: pass %d: cannot refill the marker\n", pass);
+            failed = 1;
+            return;
+        }
+    }
+}
+
+static int run(ve_algorithm_t alg, int expected_passes, int io_depth, int direct_io, int verify) {
+    const char* path = "passes.bin";
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        perror(path);
+        return 1;
+    }
+    for (size_t off = 0; off < FILE_SIZE; off += BLOCK) {
+        size_t n = FILE_SIZE - off < BLOCK ? FILE_SIZE - off : BLOCK;
+        if (write(fd, marker, n) != (ssize_t)n) {
+            perror(path);
+            close(fd);
+            return 1;
+        }
+    }
+    if (close(fd) != 0) {
+        perror(path);
+        return 1;
+    }
+
+    ve_options_t opt;
+    memset(&opt, 0, sizeof(opt));
+    opt.algorithm = alg;
+    opt.chunk_size = 64 * 1024;
+    opt.io_depth = io_depth;
+    opt.direct_io = direct_io;
+    opt.verify = verify;
+    opt.trim_mode = 2;
+    passes_seen = 0;
+    ve_status_t rc = ve_erase_path(path, &opt);
+    if (rc != VE_SUCCESS) {
+        fprintf(stderr, "FAIL: status %d: %s\n", (int)rc, ve_last_error_message());
+        return 1;
+    }
+    if (passes_seen != expected_passes) {
+        fprintf(stderr, "FAIL: %d passes checked, expected %d\n", passes_seen, expected_passes);
+        return 1;
+    }
+    if (access(path, F_OK) == 0) {
+        fprintf(stderr, "FAIL: '%s' still exists\n", path);
+        return 1;
+    }
+    return failed;
+}
+
+int main(void) {
+    static const struct {
+        const char* name;
+        ve_algorithm_t alg;
+        int passes;
+    } algs[] = {
+        { "dod3", VE_ALG_DOD3, 3 },
+        { "dod7", VE_ALG_DOD7, 7 },
+        { "gutmann", VE_ALG_GUTMANN, 35 },
+    };
+    static const struct {
+        const char* name;
+        int io_depth, direct_io, verify;
+    } modes[] = {
+        { "sync", 0, 0, 0 },
+        { "io_uring", 8, 0, 0 },
+        { "direct", 0, 1, 0 },
+        { "verify", 4, 1, 1 },
+    };
+    previous = (unsigned char*)malloc(FILE_SIZE);
+    current = (unsigned char*)malloc(FILE_SIZE);
+    if (!previous || !current) {
+        return 1;
+    }
+    memset(marker, MARKER, sizeof(marker));
+    int bad = 0;
+    for (size_t a = 0; a < sizeof(algs) / sizeof(algs[0]); ++a) {
+        for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); ++m) {
+            failed = 0;
+            if (run(algs[a].alg, algs[a].passes, modes[m].io_depth, modes[m].direct_io, modes[m].verify) != 0) {
+                fprintf(stderr, "  in %s, %s\n", algs[a].name, modes[m].name);
+                bad = 1;
+            }
+        }
+    }
+    free(previous);
+    free(current);
+    if (!bad) {
+        printf("overwrite_passes: ok\n");
+    }
+    return bad;
+}
@@ -0,0 +1,88 @@
+/*
+  Statistics of a resumed call
+  - A dod3 erase with sampled verification (verify_fraction 0.25) and a
+    journal is cancelled after its first pass, then finished by ve_resume().
+  - ve_last_stats() after the resume reports the file, the sampled blocks of
+    the resumed passes (fewer read than in the passes) and the confidence of
+    that sampling, not a perfect 1.0.
+*/
+static void test_after_pass(void* eng, int fd, int pass);
+#define VE_TEST_PASS_HOOK(eng, fd, pass) test_after_pass((eng), (fd), (pass))
+
+#include "../src/Mount/veraser.c"
+
+#include <stdio.h>
+
+#define FILE_SIZE (8u * 1024u * 1024u + 4093u)
+
+static ve_cancel_token_t cancel;
+static int cancel_after;   /* pass to cancel after; 0: never */
+
+static void test_after_pass(void* eng, int fd, int pass) {
+    (void)eng;
+    (void)fd;
+    if (pass == cancel_after) {
+        ve_cancel_request(&cancel);
+    }
+}
+
+int main(void) {
+    const char* path = "target.bin";
+    const char* journal = "resume.vej";
+    static unsigned char data[FILE_SIZE];
+    memset(data, 0xA5, sizeof(data));
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0 || write(fd, data, sizeof(data)) != (ssize_t)sizeof(data) || close(fd) != 0) {
+        perror(path);
+        return 1;
+    }
+    unlink(journal);
+
+    ve_options_ex_t ex;
+    memset(&ex, 0, sizeof(ex));
+    ex.size = sizeof(ex);
+    ex.version = VE_OPTIONS_EX_VERSION;
+    ex.base.algorithm = VE_ALG_DOD3;
+    ex.base.chunk_size = 64 * 1024;
+    ex.base.verify = 1;
+    ex.base.verify_fraction = 0.25;
+    ex.base.trim_mode = 2;
+    ex.base.journal = journal;
+    ex.cancel = &cancel;
+    cancel_after = 1;
+    ve_status_t rc = ve_erase_path_ex(path, &ex);
+    if (rc != VE_ERR_CANCELLED) {
+        fprintf(stderr, "FAIL: cancelled erase: status %d, expected %d\n", (int)rc, (int)VE_ERR_CANCELLED);
+        return 1;
+    }
+
+    cancel_after = 0;
+    rc = ve_resume(journal);
+    if (rc != VE_SUCCESS) {
+        fprintf(stderr, "FAIL: resume: status %d: %s\n", (int)rc, ve_last_error_message());
+        return 1;
+    }
+    if (access(path, F_OK) == 0) {
+        fprintf(stderr, "FAIL: '%s' still exists\n", path);
+        return 1;
+    }
+    ve_stats_t st;
+    ve_last_stats(&st);
+    if (st.files_erased != 1 || st.bytes_erased != FILE_SIZE) {
+        fprintf(stderr, "FAIL: %llu files, %llu bytes erased\n", (unsigned long long)st.files_erased,
+            (unsigned long long)st.bytes_erased);
+        return 1;
+    }
+    if (st.verify_blocks_total == 0 || st.verify_blocks == 0 || st.verify_blocks >= st.verify_blocks_total) {
+        fprintf(stderr, "FAIL: %llu of %llu blocks verified, expected a sample\n", (unsigned long long)st.verify_blocks,
+            (unsigned long long)st.verify_blocks_total);
+        return 1;
+    }
+    if (!(st.verify_confidence > 0.0 && st.verify_confidence < 1.0)) {
+        fprintf(stderr, "FAIL: verify confidence %f after a sampled resume\n", st.verify_confidence);
+        return 1;
+    }
+    unlink(journal);
+    printf("resume_stats: ok\n");
+    return 0;
+}
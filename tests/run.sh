@@ -0,0 +1,71 @@
+#!/bin/sh
+#
+# Build the veraser CLI and the C test drivers, then run the tests.
+#
+#   tests/run.sh [name ...]      run all tests, or only the named ones
+#
+# Environment:
+#   CC, CFLAGS    compiler and flags (default: cc, -O2)
+#   VE_TEST_TMP   where scratch files go (default: /var/tmp, a disk-backed
+#                 filesystem, so extents, holes and FIEMAP behave as on disk)
+#
+# A test is tests/<name>.c (linked with the engine by #include) or
+# tests/<name>.sh (run with $VERASER set to the CLI and $VE_TEST_DIR to an
+# empty scratch directory). Exit status 0 passes, 77 skips (missing root or
+# tools), anything else fails.
+
+set -u
+
+here=$(cd "$(dirname "$0")" && pwd)
+src="$here/../src/Mount"
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:--O2}
+tmp=${VE_TEST_TMP:-/var/tmp}
+
+work=$(mktemp -d "$tmp/veraser-tests.XXXXXX") || exit 1
+trap 'rm -rf "$work"' EXIT INT TERM
+
+echo "building veraser CLI"
+$CC -std=gnu11 $CFLAGS -Wall -Wextra -DVE_BUILD_CLI -o "$work/veraser" "$src/veraser.c" -lpthread || exit 1
+VERASER="$work/veraser"
+export VERASER
+
+if [ $# -eq 0 ]; then
+    set --
+    for t in "$here"/*.c "$here"/*.sh; do
+        name=$(basename "$t")
+        [ "$name" = run.sh ] && continue
+        [ -e "$t" ] && set -- "$@" "${name%.*}"
+    done
+fi
+
+pass=0 fail=0 skip=0
+for name in "$@"; do
+    VE_TEST_DIR="$work/$name.d"
+    export VE_TEST_DIR
+    mkdir -p "$VE_TEST_DIR"
+    if [ -f "$here/$name.c" ]; then
+        if ! $CC -std=gnu11 $CFLAGS -Wall -Wextra -o "$work/$name" "$here/$name.c" -lpthread; then
+            echo "FAIL: $name (build)"
+            fail=$((fail + 1))
+            continue
+        fi
+        (cd "$VE_TEST_DIR" && "$work/$name")
+    elif [ -f "$here/$name.sh" ]; then
+        sh "$here/$name.sh"
+    else
+        echo "no such test: $name"
+        fail=$((fail + 1))
+        continue
+    fi
+    rc=$?
+    case $rc in
+        0)  echo "PASS: $name"; pass=$((pass + 1)) ;;
+        77) echo "SKIP: $name"; skip=$((skip + 1)) ;;
+        *)  echo "FAIL: $name (exit $rc)"; fail=$((fail + 1)) ;;
+    esac
+    rm -rf "$VE_TEST_DIR"
+done
+
+echo "$pass passed, $fail failed, $skip skipped"
+[ $fail -eq 0 ]
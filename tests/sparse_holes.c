@@ -0,0 +1,172 @@
+/*
+  Sparse files: passes cover the data, never the holes
+  - A 16 GiB file holds four small data regions (at the start, in the
+    middle, and an odd-sized one ending at EOF) and holes everywhere else.
+  - After every dod3 pass: the size, st_blocks and the SEEK_DATA/SEEK_HOLE
+    map are what they were before the erase, and each data region holds no
+    run of the marker byte it was filled with (refilled between passes).
+  - Prints how long the erase took, as a rough benchmark: writing the holes
+    would mean 48 GiB of I/O, the data is 200 KiB.
+  - Skips when the scratch filesystem does not report holes.
+*/
+static void test_after_pass(void* eng, int fd, int pass);
+#define VE_TEST_PASS_HOOK(eng, fd, pass) test_after_pass((eng), (fd), (pass))
+
+#include "../src/Mount/veraser.c"
+
+#include <stdio.h>
+
+#define GIB (1024ULL * 1024ULL * 1024ULL)
+#define FILE_SIZE (16 * GIB + 4093)
+#define MARKER 0xA5
+#define MARKER_RUN 8      /* odds 2^-64 per offset in random data */
+#define MAX_EXTENTS 64
+
+static const struct {
+    uint64_t start, len;
+} regions[] = {
+    { 0, 4093 },
+    { 1 * GIB + 3 * 4096 + 100, 70000 },
+    { 8 * GIB - 65536, 131072 },
+    { FILE_SIZE - 10000, 10000 },
+};
+#define REGIONS (sizeof(regions) / sizeof(regions[0]))
+
+static struct stat initial;
+static uint64_t extents[MAX_EXTENTS * 2];
+static size_t nextents;
+static int passes_seen;
+static int failed;
+
+/* Data/hole map of fd into r[] (start, end pairs); returns the count or -1 */
+static long data_map(int fd, uint64_t* r, size_t max) {
+    size_t n = 0;
+    off_t pos = 0;
+    while ((uint64_t)pos < FILE_SIZE) {
+        off_t data = lseek(fd, pos, SEEK_DATA);
+        if (data < 0) {
+            return errno == ENXIO ? (long)n : -1;
+        }
+        off_t hole = lseek(fd, data, SEEK_HOLE);
+        if (hole <= data || n == max) {
+            return -1;
+        }
+        r[n * 2] = (uint64_t)data;
+        r[n * 2 + 1] = (uint64_t)hole;
+        n++;
+        pos = hole;
+    }
+    return (long)n;
+}
+
+static int fill_regions(int fd) {
+    static unsigned char marker[131072];
+    memset(marker, MARKER, sizeof(marker));
+    for (size_t i = 0; i < REGIONS; ++i) {
+        if (pwrite(fd, marker, regions[i].len, (off_t)regions[i].start) != (ssize_t)regions[i].len) {
+            return -1;
+        }
+    }
+    return fsync(fd);
+}
+
+static void test_after_pass(void* eng, int fd, int pass) {
+    (void)eng;
+    struct stat st;
+    uint64_t now[MAX_EXTENTS * 2];
+    if (fstat(fd, &st) != 0 || st.st_size != initial.st_size || st.st_blocks != initial.st_blocks) {
+        fprintf(stderr, "FAIL: pass %d: size %lld, %lld blocks; expected %lld, %lld\n", pass,
+            (long long)st.st_size, (long long)st.st_blocks, (long long)initial.st_size, (long long)initial.st_blocks);
+        failed = 1;
+        return;
+    }
+    long n = data_map(fd, now, MAX_EXTENTS);
+    if (n != (long)nextents || memcmp(now, extents, nextents * 2 * sizeof(now[0])) != 0) {
+        fprintf(stderr, "FAIL: pass %d: data/hole map changed (%ld extents, expected %zu)\n", pass, n, nextents);
+        failed = 1;
+        return;
+    }
+    static unsigned char buf[131072];
+    for (size_t i = 0; i < REGIONS; ++i) {
+        if (ve_pread_all(fd, buf, regions[i].len, regions[i].start) != 0) {
+            fprintf(stderr, "FAIL: pass %d: read back failed\n", pass);
+            failed = 1;
+            return;
+        }
+        size_t run = 0;
+        for (size_t k = 0; k < regions[i].len; ++k) {
+            run = buf[k] == MARKER ? run + 1 : 0;
+            if (run == MARKER_RUN) {
+                fprintf(stderr, "FAIL: pass %d: data at %llu not overwritten\n", pass,
+                    (unsigned long long)(regions[i].start + k + 1 - MARKER_RUN));
+                failed = 1;
+                return;
+            }
+        }
+    }
+    if (fill_regions(fd) != 0) {
+        fprintf(stderr, "FAIL: pass %d: cannot refill the marker\n", pass);
+        failed = 1;
+        return;
+    }
+    passes_seen++;
+}
+
+static int run(const char* mode, int io_depth, int direct_io, int verify) {
+    const char* path = "sparse.img";
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0 || ftruncate(fd, (off_t)FILE_SIZE) != 0 || fill_regions(fd) != 0 || fstat(fd, &initial) != 0) {
+        perror(path);
+        return 1;
+    }
+    long n = data_map(fd, extents, MAX_EXTENTS);
+    close(fd);
+    if (n <= 0 || (n == 1 && extents[0] == 0 && extents[1] == FILE_SIZE)) {
+        printf("sparse_holes: the scratch filesystem does not report holes\n");
+        unlink(path);
+        return 77;
+    }
+    nextents = (size_t)n;
+
+    ve_options_t opt;
+    memset(&opt, 0, sizeof(opt));
+    opt.algorithm = VE_ALG_DOD3;
+    opt.chunk_size = 64 * 1024;
+    opt.io_depth = io_depth;
+    opt.direct_io = direct_io;
+    opt.verify = verify;
+    opt.trim_mode = 2;
+    passes_seen = 0;
+    failed = 0;
+    uint64_t t0 = ve_now_ms();
+    ve_status_t rc = ve_erase_path(path, &opt);
+    uint64_t ms = ve_now_ms() - t0;
+    if (rc != VE_SUCCESS) {
+        fprintf(stderr, "FAIL: %s: status %d: %s\n", mode, (int)rc, ve_last_error_message());
+        unlink(path);
+        return 1;
+    }
+    if (passes_seen != 3 && !failed) {
+        fprintf(stderr, "FAIL: %s: %d passes checked, expected 3\n", mode, passes_seen);
+        return 1;
+    }
+    if (access(path, F_OK) == 0) {
+        fprintf(stderr, "FAIL: %s: '%s' still exists\n", mode, path);
+        unlink(path);
+        return 1;
+    }
+    printf("sparse_holes: %s: 16 GiB file, %zu data extents (%lld KiB allocated), dod3 in %llu ms\n",
+        mode, nextents, (long long)initial.st_blocks / 2, (unsigned long long)ms);
+    if (failed) {
+        fprintf(stderr, "  in %s\n", mode);
+    }
+    return failed;
+}
+
+int main(void) {
+    int rc = run("sync", 0, 0, 0);
+    if (rc == 0) {
+        rc = run("direct io_uring verify", 8, 1, 1);
+    }
+    return rc;
+}